@@ -15,11 +15,13 @@ void ofApp::setup(){
     //    [notice ] layer_name: 'A'
     //    [notice ] parent_name: 'Transform'
     //    [notice ] ( match_name: 'ADBE Position' )
+    //    [notice ] [ segments: constant 1, hold 1, linear 3, bezier_x_linear 1 ]
     //    [notice ] ------------
     //    [notice ] property_name: 'Rotation'
     //    [notice ] layer_name: 'B'
     //    [notice ] parent_name: 'Transform'
     //    [notice ] ( match_name: 'ADBE Rotate Z' )
+    //    [notice ] [ segments: linear 3, bezier 1 ]
     
     property_index1 = ae_easing.getPropertyIndex("Position", "A");
     property_index2 = ae_easing.getPropertyIndex("Rotation", "B");
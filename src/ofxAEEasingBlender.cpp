@@ -0,0 +1,131 @@
+#include "ofxAEEasingBlender.h"
+
+size_t ofxAEEasingBlender::addChannel(std::string property_name, std::string layer_name, std::string parent_name){
+    channels.push_back(Channel{ property_name, layer_name, parent_name, 0, 0 });
+    for (auto&& layer : layers) {
+        bind(layer, channels.size() - 1);
+    }
+    layout();
+    return channels.size() - 1;
+}
+
+size_t ofxAEEasingBlender::addLayer(const ofxAEEasingLoader& animation, float weight, BlendMode mode){
+    layers.push_back(Layer{});
+    auto&& layer = layers.back();
+    layer.animation.setTracks(animation.getSharedTracks());
+    layer.weight = weight;
+    layer.mode = mode;
+    layer.timeOffset = 0.0;
+    for (size_t c = 0; c < channels.size(); ++c) {
+        bind(layer, c);
+    }
+    layout();
+    return layers.size() - 1;
+}
+
+void ofxAEEasingBlender::bind(Layer& layer, size_t channel){
+    auto&& c = channels[channel];
+    layer.bindings.resize(channels.size(), nullptr);
+    layer.mask.resize(channels.size(), true);
+
+    size_t index;
+    if (layer.animation.findPropertyIndex(index, c.propertyName, c.layerName, c.parentName)
+        && !layer.animation.getTracks()[index].keyframes.empty()) {
+        layer.bindings[channel] = &layer.animation.getTracks()[index];
+    } else {
+        layer.bindings[channel] = nullptr;
+        ofLogWarning("ofxAEEasingBlender") << "property '" << c.propertyName << "' not found (or has no keyframes) in layer " << (&layer - layers.data());
+    }
+}
+
+void ofxAEEasingBlender::layout(){
+    size_t offset = 0;
+    size_t max_size = 0;
+    for (size_t c = 0; c < channels.size(); ++c) {
+        // channel size is the smallest number of values among bound tracks
+        size_t size = 0;
+        bool found = false;
+        for (auto&& layer : layers) {
+            auto track = layer.bindings[c];
+            if (track == nullptr) continue;
+            size_t n = track->keyframes[0].value.size();
+            size = found ? std::min(size, n) : n;
+            found = true;
+            max_size = std::max(max_size, n);
+        }
+        channels[c].offset = offset;
+        channels[c].size = size;
+        offset += size;
+    }
+    buffer.assign(offset, 0.0f);
+    scratch.assign(max_size, 0.0f);
+    covered.assign(channels.size(), false);
+}
+
+void ofxAEEasingBlender::update(float t){
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+    std::fill(covered.begin(), covered.end(), false);
+
+    for (auto&& layer : layers) {
+        if (layer.weight == 0.0) continue;
+        float layer_t = t - layer.timeOffset;
+
+        for (size_t c = 0; c < channels.size(); ++c) {
+            auto track = layer.bindings[c];
+            if (track == nullptr || !layer.mask[c]) continue;
+
+            if (!ofxAEEasingLoader::evaluateTrack(*track, layer_t, scratch.data())) continue;
+
+            float* out = buffer.data() + channels[c].offset;
+            const size_t n = channels[c].size;
+            if (layer.mode == BlendMode::ADDITIVE) {
+                for (size_t j = 0; j < n; ++j) {
+                    out[j] += scratch[j] * layer.weight;
+                }
+            } else if (!covered[c]) {
+                // no previous layer has this channel: nothing to lerp from
+                std::copy(scratch.begin(), scratch.begin() + n, out);
+            } else {
+                for (size_t j = 0; j < n; ++j) {
+                    out[j] += (scratch[j] - out[j]) * layer.weight;
+                }
+            }
+            covered[c] = true;
+        }
+    }
+}
+
+template <>
+vector<float> ofxAEEasingBlender::get(size_t channel) const {
+    const float* v = getValues(channel);
+    return vector<float>(v, v + getNumValues(channel));
+}
+
+template <>
+float ofxAEEasingBlender::get(size_t channel) const {
+    return value_at(channel, 0);
+}
+
+template <>
+ofVec2f ofxAEEasingBlender::get(size_t channel) const {
+    return ofVec2f(value_at(channel, 0), value_at(channel, 1));
+}
+
+template <>
+ofVec3f ofxAEEasingBlender::get(size_t channel) const {
+    return ofVec3f(value_at(channel, 0), value_at(channel, 1), value_at(channel, 2));
+}
+
+template <>
+ofVec4f ofxAEEasingBlender::get(size_t channel) const {
+    return ofVec4f(value_at(channel, 0), value_at(channel, 1), value_at(channel, 2), value_at(channel, 3));
+}
+
+float ofxAEEasingBlender::value_at(size_t channel, size_t j) const {
+    auto&& c = channels.at(channel);
+    if (j >= c.size) {
+        ofLogError("ofxAEEasingBlender") << "channel " << channel << " has only " << c.size << " values";
+        throw std::out_of_range("ofxAEEasingBlender: value index out of range");
+    }
+    return buffer[c.offset + j];
+}
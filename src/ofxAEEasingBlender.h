@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ofxAEEasingLoader.h"
+
+/// @brief blends multiple loaded animations (e.g. crossfade idle -> active) into one output buffer.
+///        channels are resolved to tracks of each layer once (like getPropertyIndex()),
+///        and update() evaluates all layers in a single pass without allocation.
+class ofxAEEasingBlender {
+public:
+    enum class BlendMode {
+        OVERRIDE, // lerp from the result of previous layers by weight (the first layer having the channel sets it as is)
+        ADDITIVE  // add value * weight to the result of previous layers (0 if no previous layer has the channel)
+    };
+
+    /// @brief add output channel, resolved in each layer like getPropertyIndex()
+    /// @param property_name property_name or match_name
+    /// @param layer_name optional
+    /// @param parent_name optional
+    /// @return channel index
+    size_t addChannel(std::string property_name, std::string layer_name = "", std::string parent_name = "");
+
+    /// @brief add layer. layers are applied in order of addition (use OVERRIDE with weight 1 for the base layer)
+    /// @param animation loaded animation (its tracks are shared, not copied)
+    /// @param weight 
+    /// @param mode 
+    /// @return layer index
+    size_t addLayer(const ofxAEEasingLoader& animation, float weight = 1.0, BlendMode mode = BlendMode::OVERRIDE);
+
+    void setWeight(size_t layer, float weight) {
+        layers.at(layer).weight = weight;
+    }
+
+    float getWeight(size_t layer) const {
+        return layers.at(layer).weight;
+    }
+
+    void setBlendMode(size_t layer, BlendMode mode) {
+        layers.at(layer).mode = mode;
+    }
+
+    /// @brief layer is evaluated at (t - offset) in update(t)
+    void setTimeOffset(size_t layer, float offset) {
+        layers.at(layer).timeOffset = offset;
+    }
+
+    /// @brief enable/disable channel of layer (channels are enabled by default)
+    void setMask(size_t layer, size_t channel, bool enabled) {
+        layers.at(layer).mask.at(channel) = enabled;
+    }
+
+    /// @brief evaluate all layers at time t into output buffer
+    /// @param t time (seconds)
+    void update(float t);
+
+    /// @brief return blended value of channel (evaluated by last update())
+    /// @tparam T one of float/ofVec2f/ofVec3f/ofVec4f/vector<float>
+    /// @param channel channel index
+    /// @return value (throws std::out_of_range if channel has fewer values than T)
+    template <typename T>
+    T get(size_t channel) const;
+
+    /// @brief number of values of channel (0 if no layer has the property)
+    size_t getNumValues(size_t channel) const {
+        return channels.at(channel).size;
+    }
+
+    /// @brief whole output buffer. values of channel start at getValues(channel)
+    const std::vector<float>& getBuffer() const {
+        return buffer;
+    }
+
+    const float* getValues(size_t channel) const {
+        return buffer.data() + channels.at(channel).offset;
+    }
+
+protected:
+    struct Channel {
+        std::string propertyName;
+        std::string layerName;
+        std::string parentName;
+        size_t offset;
+        size_t size;
+    };
+
+    struct Layer {
+        ofxAEEasingLoader animation;
+        float weight;
+        BlendMode mode;
+        float timeOffset;
+        std::vector<const ofxAEEasingLoader::Track*> bindings; // per channel, nullptr if not found or without keyframes
+        std::vector<bool> mask;
+    };
+
+    void bind(Layer& layer, size_t channel);
+    void layout();
+    float value_at(size_t channel, size_t j) const;
+
+    std::vector<Channel> channels;
+    std::vector<Layer> layers;
+    std::vector<float> buffer;
+    std::vector<float> scratch;
+    std::vector<bool> covered; // per channel, written by a layer in current update()
+};
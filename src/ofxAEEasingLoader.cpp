@@ -1,24 +1,8 @@
 #include "ofxAEEasingLoader.h"
 
 size_t ofxAEEasingLoader::getPropertyIndex(std::string property_name, std::string layer_name, std::string parent_name){
-    auto it = std::find_if(tracks.begin(), tracks.end(), [&property_name, &parent_name, &layer_name](const Track& t) {
-        if(parent_name != "" && layer_name != ""){
-            return (t.propertyName == property_name || t.matchName == property_name)
-                && t.parentName == parent_name
-                && t.layerName == layer_name;
-        }else if(parent_name != ""){
-            return (t.propertyName == property_name || t.matchName == property_name)
-                && t.parentName == parent_name;
-        }else if(layer_name != ""){
-            return (t.propertyName == property_name || t.matchName == property_name)
-                && t.layerName == layer_name;
-        }else{
-            return (t.propertyName == property_name || t.matchName == property_name);
-        }
-    });
-
-    if (it != tracks.end()) {
-        std::size_t index = std::distance(std::begin(tracks), it);
+    size_t index;
+    if (findPropertyIndex(index, property_name, layer_name, parent_name)) {
         return index;
     }else{
         ofLogError("ofxAEEasingLoader") << "property index not found";
@@ -26,9 +10,8 @@ size_t ofxAEEasingLoader::getPropertyIndex(std::string property_name, std::strin
     }
 }
 
-template <>
-vector<float> ofxAEEasingLoader::get(float t, std::string property_name, std::string layer_name, std::string parent_name){
-    auto it = std::find_if(tracks.begin(), tracks.end(), [&property_name, &parent_name, &layer_name](const Track& t) {
+bool ofxAEEasingLoader::findPropertyIndex(size_t& index, std::string property_name, std::string layer_name, std::string parent_name) const {
+    auto it = std::find_if(tracks->begin(), tracks->end(), [&property_name, &parent_name, &layer_name](const Track& t) {
         if(parent_name != "" && layer_name != ""){
             return (t.propertyName == property_name || t.matchName == property_name)
                 && t.parentName == parent_name
@@ -44,8 +27,54 @@ vector<float> ofxAEEasingLoader::get(float t, std::string property_name, std::st
         }
     });
 
-    if (it != tracks.end()) {
-        return get_values_at_time(it->keyframes, t);
+    if (it != tracks->end()) {
+        index = std::distance(tracks->begin(), it);
+        return true;
+    }
+    return false;
+}
+
+const std::vector<size_t>& ofxAEEasingLoader::evaluateChanged(float t){
+    changed_indices.clear();
+    if (evaluation_states.size() != tracks->size()) {
+        evaluation_states.assign(tracks->size(), EvaluationState{});
+    }
+
+    for (size_t i = 0; i < tracks->size(); ++i) {
+        const auto& track = (*tracks)[i];
+        const auto& keys = track.keyframes;
+        auto& state = evaluation_states[i];
+        if (keys.empty()) continue;
+
+        size_t span = state.evaluated ? find_span(keys, t, state.span) : find_span(keys, t);
+        bool is_constant = (span == 0 || span == keys.size());
+        if (!is_constant) {
+            SegmentType type = segment_type(track, span - 1);
+            is_constant = (type == SegmentType::CONSTANT || type == SegmentType::HOLD);
+        }
+
+        // still inside the same constant span: nothing can have changed
+        if (state.evaluated && span == state.span && is_constant) continue;
+
+        evaluation_buffer.resize(keys.front().value.size());
+        eval_span(track, span, t, evaluation_buffer.data(), nullptr);
+
+        if (!state.evaluated || evaluation_buffer != state.values) {
+            std::swap(state.values, evaluation_buffer);
+            changed_indices.push_back(i);
+        }
+        state.evaluated = true;
+        state.span = span;
+    }
+
+    return changed_indices;
+}
+
+template <>
+vector<float> ofxAEEasingLoader::get(float t, std::string property_name, std::string layer_name, std::string parent_name){
+    size_t index;
+    if (findPropertyIndex(index, property_name, layer_name, parent_name)) {
+        return get_values_at_time(tracks->at(index), t);
     } else {
         ofLogError("ofxAEEasingLoader") << "property not found";
         assert(false);
@@ -54,8 +83,8 @@ vector<float> ofxAEEasingLoader::get(float t, std::string property_name, std::st
 
 template <>
 vector<float> ofxAEEasingLoader::get(float t, size_t index){
-    auto&& track = tracks.at(index);
-    return get_values_at_time(track.keyframes, t);
+    auto&& track = tracks->at(index);
+    return get_values_at_time(track, t);
 }
 
 template <>
@@ -103,3 +132,183 @@ ofVec4f ofxAEEasingLoader::get(float t, size_t index){
     auto v = get<vector<float>>(t, index);
     return ofVec4f(v.at(0), v.at(1), v.at(2), v.at(3));
 }
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<vector<float>> ofxAEEasingLoader::getWithVelocity(float t, size_t index){
+    auto&& track = tracks->at(index);
+    ValueWithVelocity<vector<float>> r;
+    r.value = get_values_at_time(track, t, &r.velocity);
+    return r;
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<vector<float>> ofxAEEasingLoader::getWithVelocity(float t, std::string property_name, std::string layer_name, std::string parent_name){
+    return getWithVelocity<vector<float>>(t, getPropertyIndex(property_name, layer_name, parent_name));
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<float> ofxAEEasingLoader::getWithVelocity(float t, std::string property_name, std::string layer_name, std::string parent_name){
+    auto r = getWithVelocity<vector<float>>(t, property_name, layer_name, parent_name);
+    return { r.value.at(0), r.velocity.at(0) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<float> ofxAEEasingLoader::getWithVelocity(float t, size_t index){
+    auto r = getWithVelocity<vector<float>>(t, index);
+    return { r.value.at(0), r.velocity.at(0) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<ofVec2f> ofxAEEasingLoader::getWithVelocity(float t, std::string property_name, std::string layer_name, std::string parent_name){
+    auto r = getWithVelocity<vector<float>>(t, property_name, layer_name, parent_name);
+    return { ofVec2f(r.value.at(0), r.value.at(1)), ofVec2f(r.velocity.at(0), r.velocity.at(1)) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<ofVec2f> ofxAEEasingLoader::getWithVelocity(float t, size_t index){
+    auto r = getWithVelocity<vector<float>>(t, index);
+    return { ofVec2f(r.value.at(0), r.value.at(1)), ofVec2f(r.velocity.at(0), r.velocity.at(1)) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<ofVec3f> ofxAEEasingLoader::getWithVelocity(float t, std::string property_name, std::string layer_name, std::string parent_name){
+    auto r = getWithVelocity<vector<float>>(t, property_name, layer_name, parent_name);
+    return { ofVec3f(r.value.at(0), r.value.at(1), r.value.at(2)), ofVec3f(r.velocity.at(0), r.velocity.at(1), r.velocity.at(2)) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<ofVec3f> ofxAEEasingLoader::getWithVelocity(float t, size_t index){
+    auto r = getWithVelocity<vector<float>>(t, index);
+    return { ofVec3f(r.value.at(0), r.value.at(1), r.value.at(2)), ofVec3f(r.velocity.at(0), r.velocity.at(1), r.velocity.at(2)) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<ofVec4f> ofxAEEasingLoader::getWithVelocity(float t, std::string property_name, std::string layer_name, std::string parent_name){
+    auto r = getWithVelocity<vector<float>>(t, property_name, layer_name, parent_name);
+    return { ofVec4f(r.value.at(0), r.value.at(1), r.value.at(2), r.value.at(3)), ofVec4f(r.velocity.at(0), r.velocity.at(1), r.velocity.at(2), r.velocity.at(3)) };
+}
+
+template <>
+ofxAEEasingLoader::ValueWithVelocity<ofVec4f> ofxAEEasingLoader::getWithVelocity(float t, size_t index){
+    auto r = getWithVelocity<vector<float>>(t, index);
+    return { ofVec4f(r.value.at(0), r.value.at(1), r.value.at(2), r.value.at(3)), ofVec4f(r.velocity.at(0), r.velocity.at(1), r.velocity.at(2), r.velocity.at(3)) };
+}
+
+std::shared_ptr<const std::vector<ofxAEEasingLoader::Track>> ofxAEEasingLoader::AssetCache::load(const of::filesystem::path& filePath){
+    if (!of::filesystem::exists(filePath)) {
+        // not cacheable: ofLoadJson() reports the error
+        return std::make_shared<const std::vector<Track>>(parseJson(ofLoadJson(filePath)));
+    }
+
+    std::string key = of::filesystem::canonical(filePath).string();
+    FileTime mtime = of::filesystem::last_write_time(filePath);
+    uintmax_t file_size = of::filesystem::file_size(filePath);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        auto&& entry = found->second;
+        auto tracks = entry.tracks.lock();
+        if (tracks && entry.mtime == mtime && entry.fileSize == file_size) {
+            ++stats.hits;
+            entry.resident = tracks;
+            lru.splice(lru.begin(), lru, entry.lru);
+            evict();
+            return tracks;
+        }
+        // released by everyone, or file changed on disk
+        lru.erase(entry.lru);
+        entries.erase(found);
+    }
+
+    ++stats.misses;
+    auto tracks = std::make_shared<const std::vector<Track>>(parseJson(ofLoadJson(filePath)));
+    lru.push_front(key);
+    entries[key] = Entry{ mtime, file_size, tracks, tracks, estimate_bytes(*tracks), lru.begin() };
+    evict();
+
+    return tracks;
+}
+
+void ofxAEEasingLoader::AssetCache::preload(const std::vector<of::filesystem::path>& filePaths){
+    for (auto&& p : filePaths) {
+        load(p);
+    }
+
+    // load() couldn't apply budget to preloaded tracks while returning them
+    std::lock_guard<std::mutex> lock(mutex);
+    evict();
+}
+
+void ofxAEEasingLoader::AssetCache::setMemoryBudget(size_t bytes){
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+size_t ofxAEEasingLoader::AssetCache::getMemoryBudget() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget;
+}
+
+ofxAEEasingLoader::AssetCache::Stats ofxAEEasingLoader::AssetCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s = stats;
+    s.entries = 0;
+    s.bytes = 0;
+    for (auto&& e : entries) {
+        if (e.second.tracks.expired()) continue;
+        ++s.entries;
+        if (e.second.resident && e.second.resident.use_count() == 1) {
+            s.bytes += e.second.bytes;
+        }
+    }
+    return s;
+}
+
+void ofxAEEasingLoader::AssetCache::clear(){
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lru.clear();
+}
+
+size_t ofxAEEasingLoader::AssetCache::estimate_bytes(const std::vector<Track>& tracks){
+    size_t bytes = sizeof(std::vector<Track>) + tracks.capacity() * sizeof(Track);
+    for (auto&& t : tracks) {
+        bytes += t.propertyName.capacity() + t.matchName.capacity() + t.parentName.capacity() + t.layerName.capacity();
+        bytes += t.keyframes.capacity() * sizeof(Keyframe);
+        bytes += t.segmentTypes.capacity() * sizeof(SegmentType);
+        for (auto&& k : t.keyframes) {
+            bytes += k.value.capacity() * sizeof(float);
+        }
+    }
+    return bytes;
+}
+
+void ofxAEEasingLoader::AssetCache::evict(){
+    // NOTE: mutex must be held by caller
+
+    // only tracks held by the cache alone cost memory (others are shared with loaders)
+    size_t bytes = 0;
+    for (auto&& e : entries) {
+        if (e.second.resident && e.second.resident.use_count() == 1) {
+            bytes += e.second.bytes;
+        }
+    }
+
+    for (auto it = lru.end(); it != lru.begin(); ) {
+        --it;
+        auto&& entry = entries.at(*it);
+        if (bytes > budget && entry.resident && entry.resident.use_count() == 1) {
+            bytes -= entry.bytes;
+            entry.resident.reset();
+            ++stats.evictions;
+        }
+        if (entry.tracks.expired()) {
+            // released by everyone
+            entries.erase(*it);
+            it = lru.erase(it);
+        }
+    }
+}
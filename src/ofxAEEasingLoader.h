@@ -2,6 +2,10 @@
 
 #include "ofMain.h"
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 class ofxAEEasingLoader {
 public:
     enum class EaseType {
@@ -22,28 +26,124 @@ public:
         Ease inEase;
     };
 
+    /// @brief classification of a segment (keyframes[i] -> keyframes[i + 1]), decided on load
+    enum class SegmentType {
+        CONSTANT,        // values never change (equal values without overshoot)
+        HOLD,
+        LINEAR,          // linear, or bezier whose ease matches the linear speed
+        BEZIER_X_LINEAR, // bezier whose time axis is linear (influence 33.33%), so no Newton solve needed
+        BEZIER
+    };
+
     struct Track {
         std::string propertyName;
         std::string matchName;
         std::string parentName;
         std::string layerName;
         std::vector<Keyframe> keyframes;
+        std::vector<SegmentType> segmentTypes; // segmentTypes[i]: keyframes[i] -> keyframes[i + 1]
+    };
+
+    template <typename T>
+    struct ValueWithVelocity {
+        T value;
+        T velocity; // first derivative (value per second)
+    };
+
+    /// @brief process-wide cache of parsed files, shared by all loaders.
+    ///        a file is parsed again only if it is not alive (held by a loader or resident) or changed (mtime/size) on disk.
+    class AssetCache {
+    public:
+        struct Stats {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t evictions = 0;
+            size_t entries = 0; // files alive (held by loaders or resident)
+            size_t bytes = 0;   // estimated memory of tracks held only by the cache
+        };
+
+        /// @brief return tracks of filePath, parsing it only on cache miss
+        std::shared_ptr<const std::vector<Track>> load(const of::filesystem::path& filePath);
+
+        /// @brief load files in advance (e.g. before scene transition). they stay resident within memory budget
+        void preload(const std::vector<of::filesystem::path>& filePaths);
+
+        /// @brief tracks which no loader holds are kept resident up to budget, least recently used ones are evicted.
+        ///        tracks held by loaders are always shared, and don't count for budget.
+        ///        budget is applied on load(), preload() and setMemoryBudget().
+        /// @param bytes 0 means nothing is kept after loaders release it (default: 16MB)
+        void setMemoryBudget(size_t bytes);
+        size_t getMemoryBudget() const;
+
+        Stats getStats() const;
+
+        /// @brief drop all entries (loaders keep tracks which they already have)
+        void clear();
+
+    protected:
+        typedef decltype(of::filesystem::last_write_time(of::filesystem::path())) FileTime;
+
+        struct Entry {
+            FileTime mtime;
+            uintmax_t fileSize;
+            std::weak_ptr<const std::vector<Track>> tracks;     // alive while held by loaders or cache
+            std::shared_ptr<const std::vector<Track>> resident; // held by cache (null if evicted)
+            size_t bytes;
+            std::list<std::string>::iterator lru;
+        };
+
+        static size_t estimate_bytes(const std::vector<Track>& tracks);
+        void evict();
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        std::list<std::string> lru; // keys, front: most recently used
+        size_t budget = 16 * 1024 * 1024;
+        Stats stats;
     };
 
-    void load(const std::string& filePath, bool relative_to_data_path = true){
+    /// @brief return cache shared by all loaders
+    static AssetCache& getAssetCache() {
+        static AssetCache cache;
+        return cache;
+    }
+
+    void load(const std::string& filePath, bool relative_to_data_path = true, bool use_cache = true){
         if(relative_to_data_path){
-            loadPath(ofToDataPath(filePath));
+            loadPath(ofToDataPath(filePath), use_cache);
         }else{
-            loadPath(filePath);
+            loadPath(filePath, use_cache);
         }
     }
 
-    void loadPath(const of::filesystem::path& filePath){
-        loadJson(ofLoadJson(filePath));
+    void loadPath(const of::filesystem::path& filePath, bool use_cache = true){
+        if(use_cache){
+            setTracks(getAssetCache().load(filePath));
+        }else{
+            loadJson(ofLoadJson(filePath));
+        }
     }
 
     void loadJson(const nlohmann::json& j) {
-        tracks.clear();
+        setTracks(std::make_shared<const std::vector<Track>>(parseJson(j)));
+    }
+
+    /// @brief use (shared) tracks, e.g. tracks of another loader
+    void setTracks(std::shared_ptr<const std::vector<Track>> new_tracks) {
+        tracks = new_tracks ? new_tracks : std::make_shared<const std::vector<Track>>();
+        resetEvaluated();
+    }
+
+    const std::vector<Track>& getTracks() const {
+        return *tracks;
+    }
+
+    std::shared_ptr<const std::vector<Track>> getSharedTracks() const {
+        return tracks;
+    }
+
+    static std::vector<Track> parseJson(const nlohmann::json& j) {
+        std::vector<Track> tracks;
 
         size_t i = 0;
         for (const auto& d : j) {
@@ -83,17 +183,33 @@ public:
                 });
             }
 
+            auto&& segment_types = tracks[i].segmentTypes;
+            for (size_t k = 0; k + 1 < keyframes.size(); ++k) {
+                segment_types.push_back(classifySegment(keyframes[k], keyframes[k + 1]));
+            }
+
             ++i;
         }
+
+        return tracks;
     }
 
     void dumpTracks(){
-        for(auto&& t: tracks){
+        for(auto&& t: *tracks){
             ofLog() << "------------";
             ofLog() << "property_name: '" << t.propertyName << "'";
             ofLog() << "layer_name: '" << t.layerName << "'";
             ofLog() << "parent_name: '" << t.parentName << "'";
             ofLog() << "( match_name: '" << t.matchName << "' )";
+
+            std::string segments;
+            for (auto type : {SegmentType::CONSTANT, SegmentType::HOLD, SegmentType::LINEAR, SegmentType::BEZIER_X_LINEAR, SegmentType::BEZIER}) {
+                size_t count = std::count(t.segmentTypes.begin(), t.segmentTypes.end(), type);
+                if (count > 0) {
+                    segments += (segments.empty() ? "" : ", ") + segmentTypeToString(type) + " " + ofToString(count);
+                }
+            }
+            ofLog() << "[ segments: " << segments << " ]";
         }
     }
 
@@ -104,6 +220,27 @@ public:
     /// @return index of property
     size_t getPropertyIndex(std::string property_name, std::string layer_name = "", std::string parent_name = "");
 
+    /// @brief find property_index like getPropertyIndex(), but without error when not found
+    /// @param index receives index of property if found
+    /// @param property_name 
+    /// @param layer_name optional
+    /// @param parent_name optional
+    /// @return true if found
+    bool findPropertyIndex(size_t& index, std::string property_name, std::string layer_name = "", std::string parent_name = "") const;
+
+    /// @brief evaluate track at time t into buffers (no allocation)
+    /// @param track 
+    /// @param t time (seconds)
+    /// @param values receives values (size: number of values of track)
+    /// @param velocities optional. receives dValue/dt of each value
+    /// @return false (and nothing is written) if track has no keyframes
+    static bool evaluateTrack(const Track& track, float t, float* values, float* velocities = nullptr) {
+        const auto& keys = track.keyframes;
+        if (keys.empty()) return false;
+        eval_span(track, find_span(keys, t), t, values, velocities);
+        return true;
+    }
+
     /// @brief return value of property_name at time t
     /// @tparam T one of float/ofVec2f/ofVec3f/ofVec4f/vector<float>
     /// @param t time (seconds)
@@ -132,6 +269,55 @@ public:
         return get<T>(t, 0);
     }
 
+    /// @brief return value and velocity (dValue/dt) of property_name at time t in one evaluation
+    /// @tparam T one of float/ofVec2f/ofVec3f/ofVec4f/vector<float>
+    /// @param t time (seconds)
+    /// @param property_name 
+    /// @param layer_name optional
+    /// @param parent_name optional
+    /// @return value and velocity (value per second)
+    template <typename T>
+    ValueWithVelocity<T> getWithVelocity(float t, std::string property_name, std::string layer_name = "", std::string parent_name = "");
+
+    /// @brief return value and velocity (dValue/dt) of property_index at time t in one evaluation
+    /// @tparam T one of float/ofVec2f/ofVec3f/ofVec4f/vector<float>
+    /// @param t time (seconds)
+    /// @param property_index 
+    /// @return value and velocity (value per second)
+    template <typename T>
+    ValueWithVelocity<T> getWithVelocity(float t, size_t property_index);
+
+    /// @brief alias of getWithVelocity(t, 0)
+    /// @tparam T one of float/ofVec2f/ofVec3f/ofVec4f/vector<float>
+    /// @param t time (seconds)
+    /// @return value and velocity (value per second)
+    template <typename T>
+    ValueWithVelocity<T> getWithVelocity(float t) {
+        return getWithVelocity<T>(t, 0);
+    }
+
+    /// @brief evaluate all tracks at time t, and return indices of tracks whose value changed
+    ///        since the previous evaluateChanged() (all tracks are reported on the first call).
+    ///        tracks staying inside a constant/hold segment (or outside of keyframes) are not evaluated at all.
+    /// @param t time (seconds)
+    /// @return indices of changed tracks (valid until next call). use getEvaluatedValues() to read values
+    const std::vector<size_t>& evaluateChanged(float t);
+
+    /// @brief return values of property_index evaluated by the last evaluateChanged()
+    /// @param property_index 
+    /// @return values (empty if not evaluated yet)
+    const vector<float>& getEvaluatedValues(size_t property_index) const {
+        static const vector<float> empty;
+        if (property_index >= evaluation_states.size()) return empty;
+        return evaluation_states[property_index].values;
+    }
+
+    /// @brief forget state of evaluateChanged(), so that next call reports all tracks
+    void resetEvaluated() {
+        evaluation_states.clear();
+        changed_indices.clear();
+    }
+
     static const std::string easeTypeToString(EaseType ease_type) {
         if(ease_type == EaseType::BEZIER){
             return "bezier";
@@ -156,99 +342,238 @@ public:
         }
     }
 
-    std::vector<Track> tracks;
+    static const std::string segmentTypeToString(SegmentType segment_type) {
+        if(segment_type == SegmentType::CONSTANT){
+            return "constant";
+        }else if(segment_type == SegmentType::HOLD){
+            return "hold";
+        }else if(segment_type == SegmentType::LINEAR){
+            return "linear";
+        }else if(segment_type == SegmentType::BEZIER_X_LINEAR){
+            return "bezier_x_linear";
+        }else if(segment_type == SegmentType::BEZIER){
+            return "bezier";
+        }else{
+            assert(false);
+        }
+    }
+
+    /// @brief classify segment k0 -> k1, so that evaluation can skip unnecessary calculation
+    static SegmentType classifySegment(const Keyframe& k0, const Keyframe& k1) {
+        if (k0.interpolationOut == EaseType::HOLD) {
+            return SegmentType::HOLD;
+        }
+
+        bool equal_values = (k0.value == k1.value);
+
+        if (k0.interpolationOut != EaseType::BEZIER) {
+            return equal_values ? SegmentType::CONSTANT : SegmentType::LINEAR;
+        }
+
+        float dt = k1.time - k0.time;
+        float p1x = k0.outEase.influence / 100.0;
+        float p2x = 1.0 - k1.inEase.influence / 100.0;
+        float out_offset = k0.outEase.speed * dt * p1x;
+        float in_offset = k1.inEase.speed * dt * (1.0 - p2x);
+
+        if (equal_values && out_offset == 0.0 && in_offset == 0.0) {
+            return SegmentType::CONSTANT;
+        }
+
+        // if every control point lies on the straight line (y = v0 + (v1 - v0) * x), y is linear in x
+        bool linear = true;
+        for (size_t j = 0; j < k0.value.size() && j < k1.value.size(); ++j) {
+            float delta = k1.value[j] - k0.value[j];
+            float eps = 1e-4 * std::max(1.0f, std::abs(delta));
+            if (std::abs(out_offset - delta * p1x) > eps || std::abs(in_offset - delta * (1.0 - p2x)) > eps) {
+                linear = false;
+                break;
+            }
+        }
+        if (linear) {
+            return SegmentType::LINEAR;
+        }
+
+        // x(s) == s when control points are at 1/3 and 2/3
+        if (std::abs(p1x - 1.0 / 3.0) < 1e-4 && std::abs(p2x - 2.0 / 3.0) < 1e-4) {
+            return SegmentType::BEZIER_X_LINEAR;
+        }
+
+        return SegmentType::BEZIER;
+    }
 
 protected:
-    float lerp(float a, float b, float t) {
+    std::shared_ptr<const std::vector<Track>> tracks = std::make_shared<const std::vector<Track>>(); // immutable, may be shared with other loaders
+
+    struct EvaluationState {
+        bool evaluated = false;
+        size_t span = 0; // see find_span()
+        vector<float> values;
+    };
+
+    std::vector<EvaluationState> evaluation_states;
+    std::vector<size_t> changed_indices;
+    vector<float> evaluation_buffer;
+
+    static float lerp(float a, float b, float t) {
         return a + (b - a) * t;
     }
 
-    float cubic_bezier(float p0, float p1, float p2, float p3, float t) {
+    static float cubic_bezier(float p0, float p1, float p2, float p3, float t) {
         float u = 1.0 - t;
         return u*u*u*p0 + 3*u*u*t*p1 + 3*u*t*t*p2 + t*t*t*p3;
     }
 
-    float bezier_interp(
-        float t,
-        float t0, float v0, const Ease& outEase,
-        float t1, float v1, const Ease& inEase
-    ) {
-        float dt = t1 - t0;
-        if (dt <= 0.0) return v0;
-        float localT = (t - t0) / dt;
-
-        float p0x = 0.0;
-        float p3x = 1.0;
-        float p1x = outEase.influence / 100.0;
-        float p2x = 1.0 - inEase.influence / 100.0;
-
-        float p0y = v0;
-        float p3y = v1;
-
-        // The speed in AE is "the amount of change in value per second"
-        float p1y = v0 + outEase.speed * dt * (outEase.influence / 100.0);
-        float p2y = v1 - inEase.speed * dt * (inEase.influence / 100.0);
+    static float cubic_bezier_derivative(float p0, float p1, float p2, float p3, float t) {
+        float u = 1.0 - t;
+        return 3*u*u*(p1 - p0) + 6*u*t*(p2 - p1) + 3*t*t*(p3 - p2);
+    }
 
-        // Back-calculate the x corresponding to t(0-1) (approximate with Newton's method)
-        float x = localT;
+    /// @brief back-calculate the bezier parameter corresponding to x(0-1) (approximate with Newton's method)
+    static float solve_bezier_x(float x, float p1x, float p2x) {
         float guess = x;
         for (int i = 0; i < 5; ++i) {
-            float bez_x = cubic_bezier(p0x, p1x, p2x, p3x, guess);
-            float bez_dx = 3 * (1 - guess) * (1 - guess) * (p1x - p0x)
-                        + 6 * (1 - guess) * guess * (p2x - p1x)
-                        + 3 * guess * guess * (p3x - p2x);
+            float bez_x = cubic_bezier(0.0, p1x, p2x, 1.0, guess);
+            float bez_dx = cubic_bezier_derivative(0.0, p1x, p2x, 1.0, guess);
             if (bez_dx == 0.0) break;
             guess -= (bez_x - x) / bez_dx;
             if (guess < 0) guess = 0;
             if (guess > 1) guess = 1;
         }
-        float t_bez = guess;
-
-        return cubic_bezier(p0y, p1y, p2y, p3y, t_bez);
+        return guess;
     }
 
-    vector<float> get_values_at_time(const std::vector<Keyframe>& keys, float t) {
-        if (keys.empty()) return {};
-        if (t <= keys.front().time) return keys.front().value;
-        if (t >= keys.back().time) return keys.back().value;
+    /// @brief evaluate all values (and velocities) of segment k0 -> k1 at t, specialized by segment type
+    template <SegmentType S>
+    static void eval_segment_kernel(const Keyframe& k0, const Keyframe& k1, float t, float* values, float* velocities) {
+        const size_t n = k0.value.size();
+        const float dt = k1.time - k0.time;
+
+        if constexpr (S == SegmentType::CONSTANT || S == SegmentType::HOLD) {
+            std::copy(k0.value.begin(), k0.value.end(), values);
+            if (velocities) std::fill(velocities, velocities + n, 0.0f);
+        } else if constexpr (S == SegmentType::LINEAR) {
+            float localT = (t - k0.time) / dt;
+            for (size_t j = 0; j < n; ++j) {
+                values[j] = lerp(k0.value[j], k1.value[j], localT);
+                if (velocities) velocities[j] = (k1.value[j] - k0.value[j]) / dt;
+            }
+        } else {
+            float p1x = k0.outEase.influence / 100.0;
+            float p2x = 1.0 - k1.inEase.influence / 100.0;
+
+            // x(s) is shared by all values, so solve it once per segment (and never for BEZIER_X_LINEAR, where x(s) == s)
+            float s = (t - k0.time) / dt;
+            float dx = 1.0;
+            if constexpr (S == SegmentType::BEZIER) {
+                s = solve_bezier_x(s, p1x, p2x);
+                dx = cubic_bezier_derivative(0.0, p1x, p2x, 1.0, s);
+            }
 
-        const size_t n = keys[0].value.size();
+            // The speed in AE is "the amount of change in value per second"
+            float out_offset = k0.outEase.speed * dt * p1x;
+            float in_offset = k1.inEase.speed * dt * (1.0 - p2x);
 
-        vector<float> result(n, 0.0f);
+            for (size_t j = 0; j < n; ++j) {
+                float p0y = k0.value[j];
+                float p1y = p0y + out_offset;
+                float p3y = k1.value[j];
+                float p2y = p3y - in_offset;
+                values[j] = cubic_bezier(p0y, p1y, p2y, p3y, s);
+                if (velocities) {
+                    // dy/dt = (dy/ds) / (dx/ds) / dt
+                    velocities[j] = (dx > 0.0) ? cubic_bezier_derivative(p0y, p1y, p2y, p3y, s) / dx / dt : 0.0;
+                }
+            }
+        }
+    }
+
+    static void eval_segment(SegmentType type, const Keyframe& k0, const Keyframe& k1, float t, float* values, float* velocities) {
+        switch (type) {
+            case SegmentType::CONSTANT:
+                eval_segment_kernel<SegmentType::CONSTANT>(k0, k1, t, values, velocities);
+                break;
+            case SegmentType::HOLD:
+                eval_segment_kernel<SegmentType::HOLD>(k0, k1, t, values, velocities);
+                break;
+            case SegmentType::LINEAR:
+                eval_segment_kernel<SegmentType::LINEAR>(k0, k1, t, values, velocities);
+                break;
+            case SegmentType::BEZIER_X_LINEAR:
+                eval_segment_kernel<SegmentType::BEZIER_X_LINEAR>(k0, k1, t, values, velocities);
+                break;
+            case SegmentType::BEZIER:
+                eval_segment_kernel<SegmentType::BEZIER>(k0, k1, t, values, velocities);
+                break;
+        }
+    }
+
+    /// @brief return span of t: 0 if before first key, keys.size() if after last key,
+    ///        otherwise i where t is in segment keys[i - 1] -> keys[i]
+    static size_t find_span(const std::vector<Keyframe>& keys, float t) {
+        if (t <= keys.front().time) return 0;
+        if (t >= keys.back().time) return keys.size();
 
         auto it = std::lower_bound(keys.begin(), keys.end(), t, [](const Keyframe& k, float tval) {
             return k.time < tval;
         });
+        return std::distance(keys.begin(), it);
+    }
+
+    /// @brief return true if find_span(keys, t) == span
+    static bool span_contains(const std::vector<Keyframe>& keys, size_t span, float t) {
+        if (span == 0) return t <= keys.front().time;
+        if (span >= keys.size()) return t >= keys.back().time;
+        return keys[span - 1].time < t && t <= keys[span].time && t < keys.back().time;
+    }
 
-        if (it == keys.begin()) {
-            return keys.front().value;
-        } else if (it == keys.end()) {
-            return keys.back().value;
+    /// @brief find_span() starting from previous span (cheap when t moves forward frame by frame)
+    static size_t find_span(const std::vector<Keyframe>& keys, float t, size_t hint) {
+        if (span_contains(keys, hint, t)) return hint;
+        if (span_contains(keys, hint + 1, t)) return hint + 1;
+        return find_span(keys, t);
+    }
+
+    /// @brief return type of segment keyframes[i] -> keyframes[i + 1] (classified on load)
+    static SegmentType segment_type(const Track& track, size_t i) {
+        if (track.segmentTypes.size() + 1 == track.keyframes.size()) {
+            return track.segmentTypes[i];
+        }
+        // track not created by parseJson() (e.g. given by setTracks()): classify on the fly
+        return classifySegment(track.keyframes[i], track.keyframes[i + 1]);
+    }
+
+    /// @brief evaluate values (and velocities) of track at t, which is in span (see find_span())
+    static void eval_span(const Track& track, size_t span, float t, float* values, float* velocities) {
+        const auto& keys = track.keyframes;
+        if (span == 0 || span >= keys.size()) {
+            const auto& k = (span == 0) ? keys.front() : keys.back();
+            std::copy(k.value.begin(), k.value.end(), values);
+            if (velocities) std::fill(velocities, velocities + k.value.size(), 0.0f);
         } else {
-            size_t idx1 = std::distance(keys.begin(), it);
-            size_t idx0 = idx1 - 1;
-            const auto& k0 = keys[idx0];
-            const auto& k1 = keys[idx1];
-            for (size_t j = 0; j < n; ++j) {
-                if (k0.interpolationOut == EaseType::HOLD) {
-                    result[j] = k0.value[j];
-                } else if (k0.interpolationOut == EaseType::LINEAR) {
-                    float localT = (t - k0.time) / (k1.time - k0.time);
-                    result[j] = lerp(k0.value[j], k1.value[j], localT);
-                } else if (k0.interpolationOut == EaseType::BEZIER) {
-                    result[j] = bezier_interp(
-                        t,
-                        k0.time, k0.value[j], k0.outEase,
-                        k1.time, k1.value[j], k1.inEase
-                    );
-                } else {
-                    // fallback: linear
-                    float localT = (t - k0.time) / (k1.time - k0.time);
-                    result[j] = lerp(k0.value[j], k1.value[j], localT);
-                }
-            }
+            eval_segment(segment_type(track, span - 1), keys[span - 1], keys[span], t, values, velocities);
         }
+    }
+
+    /// @param velocities optional. if given, receives dValue/dt of each value at t
+    static vector<float> get_values_at_time(const Track& track, float t, vector<float>* velocities = nullptr) {
+        const auto& keys = track.keyframes;
+        if (velocities) velocities->assign(keys.empty() ? 0 : keys[0].value.size(), 0.0f);
+        if (keys.empty()) return {};
+
+        size_t span = find_span(keys, t);
+        if (span == 0) return keys.front().value;
+        if (span == keys.size()) return keys.back().value;
+
+        const auto& k0 = keys[span - 1];
+        const auto& k1 = keys[span];
+        SegmentType type = segment_type(track, span - 1);
+
+        // constant segments need no evaluation
+        if (type == SegmentType::CONSTANT || type == SegmentType::HOLD) return k0.value;
 
+        vector<float> result(k0.value.size(), 0.0f);
+        eval_segment(type, k0, k1, t, result.data(), velocities ? velocities->data() : nullptr);
         return result;
     }
 };